@@ -1,18 +1,24 @@
 #include <pebble.h>
 
-#define MAX_MC_COUNT 5
+#define MAX_MC_COUNT 20
 #define MAX_MC_STAT_COUNT 31
 #define IS_READY_RETRY_COUNT 5
 #define TIMEOUT_SECONDS 40
+#define MISSING_TIMEOUT_MS 1500
+#define MISSING_RETRY_COUNT 5
 #define HEADER_HEIGHT 16
+#define HISTORY_POINTS 24
+#define HISTORY_UNKNOWN 255
 
 static Window *mc_menu_window;
 static Window *mc_loading_window;
 static Window *mc_restaurant_window;
 static Window *mc_more_details_window;
+static Window *mc_filter_window;
 
 static MenuLayer *mc_main_menu_layer;
 static MenuLayer *mc_restaurant_menu_layer;
+static MenuLayer *mc_filter_menu_layer;
 
 static TextLayer *mc_header_text_layer;
 static TextLayer *mc_loading_text_layer;
@@ -24,6 +30,7 @@ static TextLayer *mc_working_text_layer;
 AppTimer *mc_timeout_handle = NULL;
 AppTimer *loading_dots = NULL;
 AppTimer *vibrate_handle = NULL;
+AppTimer *mc_missing_handle = NULL;
 
 static BitmapLayer *mc_timeout_bitmap_layer;
 static GBitmap *mc_timeout_bitmap;
@@ -37,13 +44,30 @@ typedef struct {
     char LAST_CHECKED[40];
     char CITY[20];
     char DOT[10];
+    int32_t DISTANCE;
+    int32_t CHECKED_MINUTES;
+    int32_t BROKEN_SINCE;
     bool is_populated;
 } mc_struct;
 
+typedef enum {
+    MC_FILTER_ALL,
+    MC_FILTER_WORKING,
+    MC_FILTER_COUNT
+} mc_filter_mode;
+
+typedef enum {
+    MC_SORT_DEFAULT,
+    MC_SORT_LAST_CHECKED,
+    MC_SORT_COUNT
+} mc_sort_mode;
+
 typedef struct {
     char CITY[30];
     char BROKEN[8];
-    uint8_t TOTAL_LOCATIONS;
+    uint16_t TOTAL_LOCATIONS;
+    uint8_t HISTORY[HISTORY_POINTS];
+    uint8_t HISTORY_COUNT;
     bool is_populated;
 } mc_stat_struct;
 
@@ -52,13 +76,22 @@ static uint8_t mc_count;
 static uint8_t mc_rest_selected;
 static uint8_t mc_menu_selected;
 static uint8_t retry_count;
+static uint8_t missing_retry_count;
+static uint8_t mc_view_count;
+static uint8_t mc_view[MAX_MC_COUNT];
+
+static mc_filter_mode mc_filter;
+static mc_sort_mode mc_sort;
 
 static bool switch_stat_buff;
 static bool is_on_error;
 static bool is_loading;
 static bool is_ready;
+static bool is_handing_off;
 
 static char mc_loaded_buffer[21];
+static char mc_header_buffer[32];
+static char mc_working_buffer[32];
 static char full_load_text[12];
 static char dots[4];
 
@@ -103,6 +136,11 @@ static void cancel_timers(void) {
         app_timer_cancel(loading_dots);
         loading_dots = NULL;
     }
+
+    if (mc_missing_handle != NULL) {
+        app_timer_cancel(mc_missing_handle);
+        mc_missing_handle = NULL;
+    }
 }
 
 static void vibrate() {
@@ -122,6 +160,61 @@ static void display_error(char *error_string) {
     }
 }
 
+static bool passes_filter(mc_struct *mc) {
+    switch (mc_filter) {
+        case MC_FILTER_WORKING:
+            return strcmp(mc->DOT, "working") == 0;
+        default:
+            return true;
+    }
+}
+
+static bool row_populated(int index) {
+    if (mc_menu_selected < 2) {
+        return mc_structs[index].is_populated;
+    }
+    return mc_stat_structs[index].is_populated;
+}
+
+/* rows that haven't arrived yet count as unknown so they sort last */
+static int32_t checked_minutes(uint8_t index) {
+    return mc_structs[index].is_populated ? mc_structs[index].CHECKED_MINUTES : -1;
+}
+
+/* true if row a should be listed after row b */
+static bool sorts_after(uint8_t a, uint8_t b) {
+    switch (mc_sort) {
+        case MC_SORT_LAST_CHECKED: {
+            int32_t a_minutes = checked_minutes(a);
+            int32_t b_minutes = checked_minutes(b);
+            if (a_minutes < 0) return b_minutes >= 0 || a > b;
+            if (b_minutes < 0) return false;
+            return a_minutes > b_minutes || (a_minutes == b_minutes && a > b);
+        }
+        default:
+            return a > b;
+    }
+}
+
+/* Rebuilds mc_view from the rows we already have, no phone needed. Rows
+   still on their way stay in as placeholders. */
+static void build_mc_view() {
+    mc_view_count = 0;
+
+    for (int i = 0; i < mc_count && i < MAX_MC_COUNT; i++) {
+        if (mc_structs[i].is_populated && !passes_filter(&mc_structs[i])) continue;
+
+        /* insertion sort, there's at most MAX_MC_COUNT of these */
+        uint8_t j = mc_view_count;
+        while (j > 0 && sorts_after(mc_view[j - 1], i)) {
+            mc_view[j] = mc_view[j - 1];
+            j--;
+        }
+        mc_view[j] = i;
+        mc_view_count++;
+    }
+}
+
 static void loadinator(int8_t index) {
     /* thanks doofenshmirtz for writing this function :) */
     if (window_stack_contains_window(mc_loading_window)) {
@@ -129,11 +222,72 @@ static void loadinator(int8_t index) {
             "Received %d of %d", index + 1, mc_count);
         text_layer_set_text(mc_loading_text_layer, mc_loaded_buffer);
 
-        if (index == mc_count - 1 && fully_populated()) {
+        /* the first row is usually the one you want, so don't wait on
+           the rest. they fill in as they arrive */
+        if (row_populated(0)) {
             vibrate();
+            is_handing_off = true;
             window_stack_remove(mc_loading_window, false);
             window_stack_push(mc_restaurant_window, true);
         }
+    } else if (window_stack_contains_window(mc_restaurant_window)) {
+        menu_layer_reload_data(mc_restaurant_menu_layer);
+    }
+
+    if (fully_populated()) {
+        is_loading = false;
+    }
+}
+
+static int8_t first_missing_index() {
+    for (int i = 0; i < mc_count; i++) {
+        if (!row_populated(i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* the phone resends rows on its own, this only kicks in when a row
+   never showed up at all */
+static void missing_callback(void *data) {
+    mc_missing_handle = NULL;
+
+    if (!is_loading || is_on_error) return;
+
+    int8_t missing = first_missing_index();
+    if (missing < 0) return;
+
+    if (missing_retry_count >= MISSING_RETRY_COUNT) {
+        display_error("Some mcData went missing.");
+        is_loading = false;
+        if (window_stack_contains_window(mc_restaurant_window)) {
+            menu_layer_reload_data(mc_restaurant_menu_layer);
+        }
+        return;
+    }
+    missing_retry_count++;
+
+    DictionaryIterator *iter;
+    if (app_message_outbox_begin(&iter) == APP_MSG_OK) {
+        dict_write_uint16(iter, MESSAGE_KEY_id, id);
+        dict_write_uint8(iter, MESSAGE_KEY_missing, missing);
+        app_message_outbox_send();
+    }
+
+    mc_missing_handle = app_timer_register(MISSING_TIMEOUT_MS, missing_callback, NULL);
+}
+
+static void watch_for_missing() {
+    missing_retry_count = 0;
+
+    if (mc_missing_handle != NULL) {
+        app_timer_cancel(mc_missing_handle);
+        mc_missing_handle = NULL;
+    }
+
+    if (!fully_populated()) {
+        mc_missing_handle = app_timer_register(MISSING_TIMEOUT_MS, missing_callback, NULL);
     }
 }
 
@@ -149,6 +303,7 @@ static void inbox_received_handler(DictionaryIterator *iterator, void *context)
     if (mc_refresh_t) {
         if (!mc_menu_selected || !is_ready || is_loading) return;
         if (window_stack_contains_window(mc_restaurant_window)) {
+            window_stack_remove(mc_filter_window, false);
             window_stack_remove(mc_more_details_window, false);
             window_stack_remove(mc_restaurant_window, false);
             window_stack_push(mc_loading_window, true);
@@ -187,6 +342,9 @@ static void inbox_received_handler(DictionaryIterator *iterator, void *context)
         Tuple *street_t = dict_find(iterator, MESSAGE_KEY_street);
         Tuple *last_checked_t = dict_find(iterator, MESSAGE_KEY_last_checked);
         Tuple *dot_t = dict_find(iterator, MESSAGE_KEY_dot);
+        Tuple *distance_t = dict_find(iterator, MESSAGE_KEY_distance);
+        Tuple *checked_minutes_t = dict_find(iterator, MESSAGE_KEY_checked_minutes);
+        Tuple *broken_since_t = dict_find(iterator, MESSAGE_KEY_broken_since);
         
         cancel_timers();
 
@@ -217,13 +375,20 @@ static void inbox_received_handler(DictionaryIterator *iterator, void *context)
                                     sizeof(mc_structs[index_t->value->int8].DOT
                                     ));
 
+            mc_structs[index_t->value->int8].DISTANCE = distance_t->value->int32;
+            mc_structs[index_t->value->int8].CHECKED_MINUTES = checked_minutes_t->value->int32;
+            mc_structs[index_t->value->int8].BROKEN_SINCE = broken_since_t->value->int32;
+
             mc_structs[index_t->value->int8].is_populated = true;
+            build_mc_view();
             
             loadinator(index_t->value->int8);
+            watch_for_missing();
         }
     } else if (strcmp(mc_message_t->value->cstring, "mc_stat_data") == 0) {
         Tuple *broken_t = dict_find(iterator, MESSAGE_KEY_broken);
         Tuple *total_locations_t = dict_find(iterator, MESSAGE_KEY_total_locations);
+        Tuple *history_t = dict_find(iterator, MESSAGE_KEY_history);
     
         cancel_timers();
 
@@ -244,16 +409,26 @@ static void inbox_received_handler(DictionaryIterator *iterator, void *context)
                                          sizeof(mc_stat_structs[index_t->value->int8].BROKEN
                                          ));
                        
-            mc_stat_structs[index_t->value->int8].TOTAL_LOCATIONS = total_locations_t->value->int8;
+            mc_stat_structs[index_t->value->int8].TOTAL_LOCATIONS = total_locations_t->value->int32;
+
+            if (history_t) {
+                uint8_t history_count = history_t->length < HISTORY_POINTS ? history_t->length : HISTORY_POINTS;
+                memcpy(mc_stat_structs[index_t->value->int8].HISTORY, history_t->value->data, history_count);
+                mc_stat_structs[index_t->value->int8].HISTORY_COUNT = history_count;
+            }
 
             mc_stat_structs[index_t->value->int8].is_populated = true;
  
             loadinator(index_t->value->int8);
+            watch_for_missing();
         }
     }
 }
 
 static void outbox_fail_callback(DictionaryIterator *iterator, AppMessageResult reason, void *context) {
+    /* missing_callback tries again by itself */
+    if (dict_find(iterator, MESSAGE_KEY_missing)) return;
+
     is_ready = false;
     display_error("Failed to send request.");
 }
@@ -273,20 +448,52 @@ static int16_t get_cell_height(MenuLayer *menu_layer, MenuIndex *cell_index, voi
 }
 
 static uint16_t get_mc_row_callback(struct MenuLayer *s_menu_layer, uint16_t section_index, void *callback_context) {
+    if (mc_menu_selected < 2) {
+        /* one row to say the filter left nothing */
+        return mc_view_count ? mc_view_count : 1;
+    }
     return mc_count;
 }
 
+/* tiny line graph of broken percentages, unknown points leave a gap */
+static void draw_sparkline(GContext *ctx, GRect box, const uint8_t *history, uint8_t count, bool highlighted) {
+    if (count < 2) return;
+
+    #if PBL_COLOR
+    graphics_context_set_stroke_color(ctx, GColorBlack);
+    #else
+    graphics_context_set_stroke_color(ctx, highlighted ? GColorWhite : GColorBlack);
+    #endif
+
+    GPoint last = GPoint(0, 0);
+    bool has_last = false;
+
+    for (int i = 0; i < count; i++) {
+        if (history[i] == HISTORY_UNKNOWN || history[i] > 100) {
+            has_last = false;
+            continue;
+        }
+
+        GPoint point = GPoint(box.origin.x + i * (box.size.w - 1) / (count - 1),
+                              box.origin.y + (box.size.h - 1) - history[i] * (box.size.h - 1) / 100);
+
+        if (has_last) {
+            graphics_draw_line(ctx, last, point);
+        }
+
+        last = point;
+        has_last = true;
+    }
+}
+
 static void draw_mc_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index,
                                      void *callback_context) 
 {
-    char *mc_street = mc_structs[cell_index->row].STREET;
-    char *mc_dot = mc_structs[cell_index->row].DOT;
-
     char *mc_stat_city = mc_stat_structs[cell_index->row].CITY;
     char *mc_stat_broken = mc_stat_structs[cell_index->row].BROKEN;
 
     char final_mc_dot[35];
-    char final_broken_perc[15];
+    char final_broken_perc[20];
 
     #if PBL_DISPLAY_HEIGHT == 168
     GRect bitmap_bounds = GRect(5, 25, 15, 15);
@@ -304,6 +511,20 @@ static void draw_mc_row_callback(GContext *ctx, const Layer *cell_layer, MenuInd
     switch (mc_menu_selected) {
         case 0:
         case 1:
+
+        if (!mc_view_count) {
+            menu_cell_basic_draw(ctx, cell_layer, "No matches", "Hold select to filter", NULL);
+            break;
+        }
+
+        /* mc_view only covers marker rows, stats can have more */
+        char *mc_street = mc_structs[mc_view[cell_index->row]].STREET;
+        char *mc_dot = mc_structs[mc_view[cell_index->row]].DOT;
+
+        if (!mc_structs[mc_view[cell_index->row]].is_populated) {
+            menu_cell_basic_draw(ctx, cell_layer, is_loading ? "Loading..." : "Not received", NULL, NULL);
+            break;
+        }
         
         if (strcmp(mc_dot, "working") == 0) {
             graphics_draw_bitmap_in_rect(ctx, working_bitmap, bitmap_bounds);
@@ -313,10 +534,23 @@ static void draw_mc_row_callback(GContext *ctx, const Layer *cell_layer, MenuInd
             graphics_draw_bitmap_in_rect(ctx, inac_bitmap, bitmap_bounds);
         }
 
-        snprintf(final_mc_dot, sizeof(final_mc_dot), "      %s", mc_dot);
+        int32_t mc_distance = mc_structs[mc_view[cell_index->row]].DISTANCE;
+        if (mc_menu_selected == 0 && mc_distance > 0) {
+            /* meters from the phone, shown in tenths of a mile */
+            int32_t tenths = (mc_distance * 10 + 804) / 1609;
+            snprintf(final_mc_dot, sizeof(final_mc_dot), "      %s, %d.%d mi", mc_dot, 
+                (int)(tenths / 10), (int)(tenths % 10));
+        } else {
+            snprintf(final_mc_dot, sizeof(final_mc_dot), "      %s", mc_dot);
+        }
         menu_cell_basic_draw(ctx, cell_layer, mc_street, final_mc_dot, NULL);
             break;
         case 2:
+
+        if (!mc_stat_structs[cell_index->row].is_populated) {
+            menu_cell_basic_draw(ctx, cell_layer, is_loading ? "Loading..." : "Not received", NULL, NULL);
+            break;
+        }
                 
         if (!mc_stat_structs[cell_index->row].TOTAL_LOCATIONS) {
             snprintf(final_mc_dot, sizeof(mc_stat_structs[cell_index->row].CITY), "%s", mc_stat_city);
@@ -332,6 +566,17 @@ static void draw_mc_row_callback(GContext *ctx, const Layer *cell_layer, MenuInd
         }
 
         menu_cell_basic_draw(ctx, cell_layer, final_broken_perc, final_mc_dot, NULL);
+
+        GRect cell_bounds = layer_get_bounds(cell_layer);
+        #if PBL_DISPLAY_HEIGHT == 168
+        GRect sparkline_bounds = GRect(cell_bounds.size.w - 50, 6, 44, 16);
+        #elif PBL_DISPLAY_HEIGHT == 228
+        GRect sparkline_bounds = GRect(cell_bounds.size.w - 66, 8, 58, 22);
+        #endif
+        if (!(switch_stat_buff && mc_rest_selected == cell_index->row)) {
+            draw_sparkline(ctx, sparkline_bounds, mc_stat_structs[cell_index->row].HISTORY, 
+                mc_stat_structs[cell_index->row].HISTORY_COUNT, menu_cell_layer_is_highlighted(cell_layer));
+        }
             break;
     }
 }
@@ -342,6 +587,8 @@ static void mc_restaurant_selection_callback(struct MenuLayer *s_menu_layer, Men
     switch (mc_menu_selected) {
         case 0:
         case 1:
+        if (!mc_view_count || !mc_structs[mc_view[cell_index->row]].is_populated) break;
+        mc_rest_selected = mc_view[cell_index->row];
         window_stack_push(mc_more_details_window, true);
             break;
         case 2:
@@ -353,28 +600,23 @@ static void mc_restaurant_selection_callback(struct MenuLayer *s_menu_layer, Men
     }
 }
 
+static void mc_restaurant_long_selection_callback(struct MenuLayer *s_menu_layer, MenuIndex *cell_index, void *callback_context) {
+    if (mc_menu_selected < 2) {
+        window_stack_push(mc_filter_window, true);
+    }
+}
+
 static void draw_mc_menu_header(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
     menu_cell_basic_header_draw(ctx, cell_layer, "mcbroken");
 }
 
 static void reset_mcdata() {
-    for (int i = 0; i < MAX_MC_COUNT; i++) {
-        memset(&mc_structs->STREET[i], 0, sizeof(mc_structs->STREET[i]));
-        memset(&mc_structs->LAST_CHECKED[i], 0, sizeof(mc_structs->LAST_CHECKED[i]));
-        memset(&mc_structs->CITY[i], 0, sizeof(mc_structs->CITY[i]));
-        memset(&mc_structs->DOT[i], 0, sizeof(mc_structs->DOT[i]));
-        mc_structs[i].is_populated = false;
-    }
-
-    for (int i = 0; i < MAX_MC_STAT_COUNT; i++) {
-        memset(&mc_stat_structs->CITY[i], 0, sizeof(mc_stat_structs->CITY[i]));
-        memset(&mc_stat_structs->BROKEN[i], 0, sizeof(mc_stat_structs->BROKEN[i]));
-        mc_stat_structs[i].TOTAL_LOCATIONS = 0;
-        mc_stat_structs[i].is_populated = false;
-    }
+    memset(mc_structs, 0, sizeof(mc_structs));
+    memset(mc_stat_structs, 0, sizeof(mc_stat_structs));
     
     switch_stat_buff = false;
     mc_count = 0;
+    mc_view_count = 0;
 }
 
 static void load_mcdata() {
@@ -449,6 +691,18 @@ static void draw_mc_menu_row_callback(GContext *ctx, const Layer *cell_layer, Me
 
 /* --- window code --- */
 
+static void format_broken_since(char *buffer, size_t size, int32_t minutes) {
+    if (minutes < 0) {
+        snprintf(buffer, size, "Machine Broken");
+    } else if (minutes < 60) {
+        snprintf(buffer, size, "Broken for %dm", (int)minutes);
+    } else if (minutes < 24 * 60) {
+        snprintf(buffer, size, "Broken for %dh %dm", (int)(minutes / 60), (int)(minutes % 60));
+    } else {
+        snprintf(buffer, size, "Broken for %dd %dh", (int)(minutes / (24 * 60)), (int)((minutes / 60) % 24));
+    }
+}
+
 static void mc_more_details_load(Window *window) {
     Layer *window_layer = window_get_root_layer(window);
     GRect bounds = layer_get_bounds(window_layer);
@@ -556,7 +810,9 @@ static void mc_more_details_load(Window *window) {
     if (strcmp(mc_structs[mc_rest_selected].DOT, "working") == 0) {
         text_layer_set_text(mc_working_text_layer, "Machine Working");
     } else if (strcmp(mc_structs[mc_rest_selected].DOT, "broken") == 0) {
-        text_layer_set_text(mc_working_text_layer, "Machine Broken");
+        format_broken_since(mc_working_buffer, sizeof(mc_working_buffer), 
+            mc_structs[mc_rest_selected].BROKEN_SINCE);
+        text_layer_set_text(mc_working_text_layer, mc_working_buffer);
     } else {
         text_layer_set_text(mc_working_text_layer, "Status could not be determined");
     }
@@ -582,6 +838,23 @@ static void stat_sel_changed_callback(struct MenuLayer *menu_layer, MenuIndex *n
     switch_stat_buff = false;
 }
 
+static void update_mc_header() {
+    switch (mc_menu_selected) {
+        case 0:
+            snprintf(mc_header_buffer, sizeof(mc_header_buffer), "Nearby %s",
+                mc_filter == MC_FILTER_WORKING ? "working only" : "locations");
+            break;
+        case 1:
+            snprintf(mc_header_buffer, sizeof(mc_header_buffer), "Saved %s",
+                mc_filter == MC_FILTER_WORKING ? "working only" : "locations");
+            break;
+        case 2:
+            snprintf(mc_header_buffer, sizeof(mc_header_buffer), "Stats");
+            break;
+    }
+    text_layer_set_text(mc_header_text_layer, mc_header_buffer);
+}
+
 static void mc_restaurant_window_load(Window *window) {
     Layer *window_layer = window_get_root_layer(window);
     GRect bounds = layer_get_bounds(window_layer);
@@ -605,6 +878,7 @@ static void mc_restaurant_window_load(Window *window) {
         .get_cell_height = get_cell_height,
         .draw_row = draw_mc_row_callback,
         .select_click = mc_restaurant_selection_callback,
+        .select_long_click = mc_restaurant_long_selection_callback,
         .selection_will_change = stat_sel_changed_callback
     };
 
@@ -614,21 +888,17 @@ static void mc_restaurant_window_load(Window *window) {
     layer_add_child(window_layer, menu_layer_get_layer(mc_restaurant_menu_layer));
     
     light_enable_interaction();
-
-    switch (mc_menu_selected) {
-        case 0:
-            text_layer_set_text(mc_header_text_layer, "Nearby locations");
-            break;
-        case 1:
-            text_layer_set_text(mc_header_text_layer, "Saved locations");
-            break;
-        case 2:
-            text_layer_set_text(mc_header_text_layer, "Stats");
-            break;
-    }
+    update_mc_header();
 }
 
+static void stop_loading(void);
+
 static void mc_restaurant_window_unload(Window *window) {
+    /* backed out before everything arrived */
+    if (is_loading) {
+        stop_loading();
+    }
+
     text_layer_destroy(mc_header_text_layer);
     menu_layer_destroy(mc_restaurant_menu_layer);
 }
@@ -700,17 +970,12 @@ static void mc_loading_screen_load(Window *window) {
     layer_add_child(window_layer, text_layer_get_layer(mc_loading_text_layer));
 }
 
-static void mc_loading_screen_unload(Window *window) {
+static void stop_loading() {
     cancel_timers();
     is_loading = false;
     is_on_error = false;
     id = 0;
     
-    if (vibrate_handle != NULL) {
-        app_timer_cancel(vibrate_handle);
-        vibrate_handle = NULL;
-    }
-    
     if (is_ready && connection_service_peek_pebble_app_connection()) {
         DictionaryIterator *iter;
         app_message_outbox_begin(&iter);
@@ -718,6 +983,23 @@ static void mc_loading_screen_unload(Window *window) {
         dict_write_uint16(iter, MESSAGE_KEY_id, 0);
         app_message_outbox_send();
     }
+}
+
+static void mc_loading_screen_unload(Window *window) {
+    if (is_handing_off) {
+        /* the restaurant list took over, the rest of the rows still
+           need to come in */
+        is_handing_off = false;
+        cancel_timers();
+        watch_for_missing();
+    } else {
+        stop_loading();
+    }
+    
+    if (vibrate_handle != NULL) {
+        app_timer_cancel(vibrate_handle);
+        vibrate_handle = NULL;
+    }
     
     memset(mc_loaded_buffer, 0, sizeof(mc_loaded_buffer));
     memset(&dots, 0, sizeof(dots));
@@ -726,6 +1008,70 @@ static void mc_loading_screen_unload(Window *window) {
     bitmap_layer_destroy(mc_timeout_bitmap_layer);
 }
 
+static uint16_t get_mc_filter_row_callback(struct MenuLayer *s_menu_layer, uint16_t section_index, void *callback_context) {
+    return 2;
+}
+
+static void draw_mc_filter_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+    switch (cell_index->row) {
+        case 0:
+        menu_cell_basic_draw(ctx, cell_layer, "Show", 
+            mc_filter == MC_FILTER_WORKING ? "Working only" : "All locations", NULL);
+            break;
+        case 1:
+        menu_cell_basic_draw(ctx, cell_layer, "Sort by", 
+            mc_sort == MC_SORT_LAST_CHECKED ? "Last checked" 
+                : (mc_menu_selected == 0 ? "Search ranking" : "Saved order"), NULL);
+            break;
+    }
+}
+
+static void mc_filter_selection_callback(struct MenuLayer *s_menu_layer, MenuIndex *cell_index, void *callback_context) {
+    switch (cell_index->row) {
+        case 0:
+        mc_filter = (mc_filter + 1) % MC_FILTER_COUNT;
+            break;
+        case 1:
+        mc_sort = (mc_sort + 1) % MC_SORT_COUNT;
+            break;
+    }
+
+    build_mc_view();
+    menu_layer_reload_data(s_menu_layer);
+
+    if (window_stack_contains_window(mc_restaurant_window)) {
+        update_mc_header();
+        menu_layer_set_selected_index(mc_restaurant_menu_layer, (MenuIndex) { 0, 0 }, MenuRowAlignTop, false);
+        menu_layer_reload_data(mc_restaurant_menu_layer);
+    }
+}
+
+static void mc_filter_window_load(Window *window) {
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    mc_filter_menu_layer = menu_layer_create(bounds);
+
+    #if PBL_COLOR
+    menu_layer_set_highlight_colors(mc_filter_menu_layer, GColorChromeYellow, GColorBlack);
+    #endif
+
+    static const MenuLayerCallbacks mc_menu_callbacks = {
+        .get_num_rows = get_mc_filter_row_callback,
+        .get_cell_height = get_cell_height,
+        .draw_row = draw_mc_filter_row_callback,
+        .select_click = mc_filter_selection_callback
+    };
+
+    menu_layer_set_callbacks(mc_filter_menu_layer, NULL, mc_menu_callbacks);
+    menu_layer_set_click_config_onto_window(mc_filter_menu_layer, window);
+    layer_add_child(window_layer, menu_layer_get_layer(mc_filter_menu_layer));
+}
+
+static void mc_filter_window_unload(Window *window) {
+    menu_layer_destroy(mc_filter_menu_layer);
+}
+
 static void mc_main_menu_load(Window *window) {
     Layer *window_layer = window_get_root_layer(window);
     GRect bounds = layer_get_bounds(window_layer);
@@ -783,6 +1129,13 @@ static void init() {
         .unload = mc_more_details_unload
     });
 
+    mc_filter_window = window_create();
+    window_set_window_handlers(mc_filter_window, 
+    (WindowHandlers) {
+        .load = mc_filter_window_load,
+        .unload = mc_filter_window_unload
+    });
+
     #if PBL_COLOR
     #if PBL_DISPLAY_HEIGHT == 168
     mc_timeout_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_MCHADIT);
@@ -826,6 +1179,7 @@ static void deinit() {
     window_destroy(mc_loading_window);
     window_destroy(mc_restaurant_window);
     window_destroy(mc_more_details_window);
+    window_destroy(mc_filter_window);
 }
 
 int main(void) {
@@ -52,6 +52,44 @@ module.exports = [
       },
     ]
   },
+  {
+    "type": "section",
+    "items": [
+      {
+        "type": "heading",
+        "defaultValue": "nearby"
+      },
+      {
+        "type": "slider",
+        "messageKey": "mc_nearby_count",
+        "defaultValue": 20,
+        "label": "Number of nearby locations",
+        "min": 5,
+        "max": 20,
+        "step": 1
+      },
+      {
+        "type": "slider",
+        "messageKey": "mc_nearby_max_distance",
+        "defaultValue": 25,
+        "label": "Max search distance (miles)",
+        "min": 5,
+        "max": 50,
+        "step": 5
+      },
+      {
+        "type": "select",
+        "messageKey": "mc_nearby_rank",
+        "defaultValue": "nearest",
+        "label": "Sort nearby by",
+        "options": [
+          { "label": "Nearest", "value": "nearest" },
+          { "label": "Nearest working", "value": "nearest_working" },
+          { "label": "Recently checked", "value": "fresh" }
+        ]
+      }
+    ]
+  },
   {
     "type": "section",
     "items": [
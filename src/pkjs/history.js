@@ -0,0 +1,141 @@
+/* A small history of stats and saved location statuses, kept in
+   localStorage. Each snapshot only stores the values that changed since the
+   one before it, so a city that sits at 20% broken for a month costs next
+   to nothing. When we run out of room the older half gets thinned out by
+   folding every other snapshot into the one after it. */
+
+const storage_key = 'mc_history';
+const max_snapshots = 96;
+const max_bytes = 16384;
+const quiet_minutes = 60; // unchanged snapshots closer together than this are skipped
+
+var snapshots = [];
+var current = {};
+
+function now_minutes() {
+    return Math.floor(new Date().getTime() / 60000);
+}
+
+function restore() {
+    var stored;
+    try {
+        stored = JSON.parse(localStorage.getItem(storage_key));
+    } catch (error) {
+        console.log(error);
+    }
+
+    if (!stored || !Array.isArray(stored.snapshots)) return;
+
+    snapshots = stored.snapshots;
+    snapshots.forEach(snapshot => {
+        Object.assign(current, snapshot.d);
+    });
+}
+
+function persist() {
+    var stored = JSON.stringify({ snapshots: snapshots });
+
+    while (stored.length > max_bytes && snapshots.length > 1) {
+        downsample();
+        stored = JSON.stringify({ snapshots: snapshots });
+    }
+
+    try {
+        localStorage.setItem(storage_key, stored);
+    } catch (error) {
+        console.log(error);
+    }
+}
+
+/* folds snapshot i into the one after it, keeping what the next one
+   would have looked like */
+function drop(i) {
+    const next = snapshots[i + 1];
+    next.d = Object.assign({}, snapshots[i].d, next.d);
+    snapshots.splice(i, 1);
+}
+
+/* thins out the older half, the recent half keeps full resolution */
+function downsample() {
+    const older = Math.max(Math.floor(snapshots.length / 2), 1);
+    for (let i = older - 1; i >= 0; i -= 2) {
+        if (i + 1 < snapshots.length) {
+            drop(i);
+        }
+    }
+}
+
+/* Records `values` ({ key: number }) as of `then` (ms since epoch) */
+function mcHistoryRecord(then, values) {
+    const t = Math.floor(then / 60000);
+    const last = snapshots[snapshots.length - 1];
+    const delta = {};
+
+    if (last && t < last.t) return;
+
+    Object.keys(values).forEach(key => {
+        if (current[key] !== values[key]) {
+            delta[key] = values[key];
+        }
+    });
+
+    if (last && t === last.t) {
+        Object.assign(last.d, delta);
+    } else if (Object.keys(delta).length > 0 || !last || t - last.t >= quiet_minutes) {
+        snapshots.push({ t: t, d: delta });
+    } else {
+        return;
+    }
+
+    Object.assign(current, delta);
+
+    while (snapshots.length > max_snapshots) {
+        downsample();
+    }
+
+    persist();
+}
+
+/* The last `points` values for `key`, oldest first. Snapshots from before
+   the key showed up come back as null. */
+function mcHistorySeries(key, points) {
+    const series = [];
+    var value = null;
+
+    snapshots.forEach(snapshot => {
+        if (snapshot.d.hasOwnProperty(key)) {
+            value = snapshot.d[key];
+        }
+        series.push(value);
+    });
+
+    return series.slice(-points);
+}
+
+/* How many minutes `key` has had `value` for without a break, or -1 if it
+   doesn't have it right now or we never saw it change to it */
+function mcHistorySince(key, value) {
+    if (current[key] !== value) return -1;
+
+    /* deltas only hold changes, so the newest snapshot mentioning the key
+       is where the current run started. if nothing older mentions it, that
+       snapshot is just the first time we saw the key, not a change */
+    var started = -1;
+    for (let i = snapshots.length - 1; i >= 0; i--) {
+        if (!snapshots[i].d.hasOwnProperty(key)) continue;
+        if (started >= 0) {
+            return Math.max(now_minutes() - snapshots[started].t, 0);
+        }
+        started = i;
+    }
+
+    return -1;
+}
+
+restore();
+
+module.exports = {
+    record: mcHistoryRecord,
+    series: mcHistorySeries,
+    since: mcHistorySince
+};
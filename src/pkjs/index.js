@@ -1,28 +1,35 @@
 var Clay = require('pebble-clay');
 var clayConfig = require('./config');
 var clay = new Clay(clayConfig, null, { autoHandleEvents: false });
+var mcStats = require('./stats');
+var mcTransport = require('./transport');
+var mcTiles = require('./tiles');
+var mcHistory = require('./history');
+var mcScheduler = require('./scheduler');
+var mcNearby = require('./nearby');
 
 /* This code is an NSFW warning (it sucks) */
 
 var URL = 'https://data.mcbroken.com'
 var MARKERS = '/markers.json'
-var STATS = '/stats.json'
 
-var xhr_markers;
-var xhr_stats;
-
-var id_gps;
-var current_id;
-var current_request;
-var mc_selected;
-var send_id;
+/* the job for whatever view the watch is waiting on */
+var view_ctx;
 
 let cache_max_age = 60 // seconds
+let stale_max_age = 60 * 60 // seconds, how old tiles can be and still get served
+let history_points = 24
+
+/* what a saved location's status looks like in mcHistory */
+const history_status = Object.freeze({
+    working: 0,
+    broken: 100,
+    inactive: -1,
+    unknown: 255
+});
 
-let markers_cache = [];
-let stats_cache = [];
-let markers_then = [];
-let stats_then = [];
+let markers_waiting = [];
+let markers_loading = false;
 
 const error = Object.freeze({
     connection_timed_out: "mcConnection timed out.",
@@ -50,29 +57,13 @@ const not_found_feature = {
         country: null,
         last_checked: 'Checked 67 minutes ago' // laugh
     },
-    type: 'Feature'
+    type: 'Feature',
+    placeholder: true // the joke above isn't a real check time
 };
 
-function mcSend(messages, id) {
-    if (id !== undefined) {
-        send_id = id;
-    }
-
-    setTimeout(() => {
-        if (messages.length === 0 || send_id !== current_id) return;
-        message = messages.shift();
-        Pebble.sendAppMessage(message, function() {
-            mcSend(messages);
-        },
-        function (e) {
-            console.log("I've McFallen! I'm Sorry! I've McFallen!");
-        });
-    }, 50);
-}
-
-function sendmcError(type, error_message, id) {
+function sendmcError(ctx, error_message) {
     var mc_error_type;
-    if (!type) {
+    if (!ctx.type) {
         mc_error_type = "mc_marker_error";
     } else {
         mc_error_type = "mc_stat_error";
@@ -80,131 +71,130 @@ function sendmcError(type, error_message, id) {
     const message = { 
         'mc_message': mc_error_type,
         'error': error_message,
-        'id': id
+        'id': ctx.id
     };
-    if (id !== current_id) return;
+    if (!ctx.live() || ctx.id === undefined) return;
     Pebble.sendAppMessage(message);
 }
 
-function mcRequestMarkers(id) {
+function mcMarkersLoaded(error_message) {
+    const waiting = markers_waiting;
+    markers_waiting = [];
+    markers_loading = false;
+
+    waiting.forEach(entry => {
+        if (!entry.ctx.live()) return;
+        if (error_message) {
+            sendmcError(entry.ctx, error_message);
+            entry.ctx.done();
+        } else {
+            entry.resolve();
+        }
+    });
+}
+
+/* Resolves straight away if mcTiles holds anything newer than
+   stale_max_age (like the tiles restored on a warm start) and `force`
+   isn't set, kicking off a background refresh once it's older than
+   cache_max_age. Otherwise resolves after a download. Everyone asking
+   while a download is going waits on that same download. */
+function mcRequestMarkers(ctx, force) {
     return new Promise((resolve) => { 
-        const now = new Date().getTime();
+        const age = new Date().getTime() - mcTiles.then();
 
-        if (Object.keys(markers_cache).length > 0 && now - markers_then < cache_max_age * 1000) {
-            resolve(markers_cache);
-        } else if (Object.keys(markers_cache).length > 0 && now - markers_then >= cache_max_age * 1000) {
-            xhr_markers = undefined;
+        if (!force && mcTiles.then() && age < stale_max_age * 1000) {
+            if (age >= cache_max_age * 1000) {
+                mc_revalidate();
+            }
+            resolve();
+            return;
         }
+
+        markers_waiting.push({ ctx: ctx, resolve: resolve });
         
-        if (xhr_markers) return;
-        xhr_markers = new XMLHttpRequest();
-        xhr_markers.open('GET', URL + MARKERS, true);
-
-        xhr_markers.timeout = 10000;                
-        xhr_markers.setRequestHeader('Content-Type', 'application/json');
-        xhr_markers.send();
-
-        xhr_markers.onload = function() {
-            if (xhr_markers && xhr_markers.status === 200 && xhr_markers.readyState === 4) {
-                try {
-                    markers_cache = JSON.parse(xhr_markers.responseText);
-                } catch (error) {
-                    console.log(error);
-                    sendmcError(request.type_markers, error.could_not_parse, current_id);
-                    xhr_markers = undefined;
-                    cache = [];
-                    return;
-                }
+        if (markers_loading) return;
+        markers_loading = true;
+
+        ctx.use('network', function(release) {
+            var xhr_markers = new XMLHttpRequest();
+            var finished = false;
+
+            function finish(error_message) {
+                if (finished) return;
+                finished = true;
+                release();
+                mcMarkersLoaded(error_message);
+            }
 
-                markers_then = new Date().getTime();
+            xhr_markers.open('GET', URL + MARKERS, true);
 
-                /* hacky workaround, but whatever */
-                if (current_id !== id && id) {
-                    mcLoad();
-                    return;
-                }
+            xhr_markers.timeout = 10000;                
+            xhr_markers.setRequestHeader('Content-Type', 'application/json');
+            xhr_markers.send();
 
-                resolve(markers_cache);
-            }
-        };
-        xhr_markers.onloadend = function() {
-            if (xhr_markers && xhr_markers.status == 404) {
-                sendmcError(request.type_markers, error.could_not_connect, current_id);
-                xhr_markers = undefined;
-                return;
-            }
-        }
-        xhr_markers.onerror = function() {
-            sendmcError(request.type_markers, error.could_not_connect, current_id);
-            xhr_markers = undefined;
-            return;
-        }
-        xhr_markers.ontimeout = function() {
-            sendmcError(request.type_markers, error.connection_timed_out, current_id);
-            xhr_markers = undefined;
-            return;
-        }
-    });
-}
+            xhr_markers.onload = function() {
+                if (xhr_markers.status === 200 && xhr_markers.readyState === 4) {
+                    var features;
+                    try {
+                        features = JSON.parse(xhr_markers.responseText).features;
+                    } catch (e) {
+                        console.log(e);
+                    }
 
-function mcRequestStats(id) {
-    return new Promise((resolve) => { 
-        const now = new Date().getTime();
+                    if (!Array.isArray(features)) {
+                        finish(error.could_not_parse);
+                        return;
+                    }
 
-        if (Object.keys(stats_cache).length > 0 && now - stats_then < cache_max_age * 1000) {
-            resolve(stats_cache);
-        } else if (Object.keys(stats_cache).length > 0 && now - stats_then >= cache_max_age * 1000) {
-            xhr_stats = undefined;
-        }
-        
-        if (xhr_stats) return;
-        xhr_stats = new XMLHttpRequest();
-        xhr_stats.open('GET', URL + STATS, true);
-
-        xhr_stats.timeout = 10000;                
-        xhr_stats.setRequestHeader('Content-Type', 'application/json');
-        xhr_stats.send();
-
-        xhr_stats.onload = function() {
-            if (xhr_stats && xhr_stats.status === 200 && xhr_stats.readyState === 4) {
-                try {
-                    stats_cache = JSON.parse(xhr_stats.responseText);
-                } catch (error) {
-                    console.log(error);
-                    sendmcError(request.type_stats, error.could_not_parse, current_id);
-                    xhr_stats = undefined;
-                    stats_cache = [];
-                    return;
-                }
+                    const then = new Date().getTime();
+                    const streets = mc_saved_streets();
 
-                stats_then = new Date().getTime();
+                    mcStats.refresh(features, then);
+                    mcTiles.ingest(features, then, feature => {
+                        return streets.some(street => is_saved_feature(feature, street));
+                    });
+                    mc_record_history(features, then, streets);
 
-                /* hacky workaround, but whatever */
-                if (current_id !== id && id) {
-                    mcLoad();
+                    finish();
+                }
+            };
+            xhr_markers.onloadend = function() {
+                /* 500s and friends never get past onload, don't leave
+                   everyone waiting on them */
+                if (xhr_markers.status !== 200) {
+                    finish(error.could_not_connect);
                     return;
                 }
-
-                resolve(stats_cache);
             }
-        };
-        xhr_stats.onloadend = function() {
-            if (xhr_stats && xhr_stats.status == 404) {
-                sendmcError(request.type_stats, error.could_not_connect, current_id);
-                xhr_stats = undefined;
+            xhr_markers.onerror = function() {
+                finish(error.could_not_connect);
                 return;
             }
-        }
-        xhr_stats.onerror = function() {
-            sendmcError(request.type_stats, error.could_not_connect, current_id);
-            xhr_stats = undefined;
-            return;
-        }
-        xhr_stats.ontimeout = function() {
-            sendmcError(request.type_stats, error.connection_timed_out, current_id);
-            xhr_stats = undefined;
+            xhr_markers.ontimeout = function() {
+                finish(error.connection_timed_out);
+                return;
+            }
+        });
+    });
+}
+
+/* getCurrentPosition, but taking turns through the scheduler */
+function mcGetPosition(ctx, gps_options, success, failure) {
+    ctx.use('gps', function(release) {
+        if (!ctx.live()) {
+            release();
             return;
         }
+
+        navigator.geolocation.getCurrentPosition(function(pos) {
+            release();
+            if (!ctx.live()) return;
+            success([ pos.coords.latitude, pos.coords.longitude ]);
+        }, function(err) {
+            release();
+            if (!ctx.live()) return;
+            failure(err);
+        }, gps_options);
     });
 }
 
@@ -227,24 +217,99 @@ function mcCalculateDistance(mc_location, current_loc) {
     return R * c;
 }
 
-function format_and_send(type, result, id) {
+/* "Checked 67 minutes ago" -> 67, or -1 if we can't tell */
+function mcCheckedMinutes(last_checked) {
+    const minutes_per = { second: 0, minute: 1, hour: 60, day: 1440, week: 10080, month: 43200 };
+    const match = /(\d+|an?)\s+(second|minute|hour|day|week|month)/i.exec(last_checked || '');
+
+    if (/less than|just now/i.test(last_checked || '')) return 0;
+    if (!match) return -1;
+
+    const amount = isNaN(parseInt(match[1])) ? 1 : parseInt(match[1]);
+    return amount * minutes_per[match[2].toLowerCase()];
+}
+
+function mc_history_key(props) {
+    return 's:' + (props.street || '').toLowerCase().trim();
+}
+
+function mc_history_status(props) {
+    if (!props.is_active) return history_status.inactive;
+    return props.is_broken ? history_status.broken : history_status.working;
+}
+
+function mc_stat_count() {
+    try {
+        var settings = JSON.parse(localStorage.getItem("clay-settings"));
+    } catch (error) {
+        console.log(error);
+    }
+
+    if (!settings || !settings.mc_stat_count) {
+        return 16;
+    }
+    return settings.mc_stat_count;
+}
+
+/* points the near me stats rows at coords, or leaves them out */
+function mc_stats_near(coords) {
+    let radius = 8.04672
+
+    if (coords && mcTiles.covers(coords, radius)) {
+        mcStats.near(mcTiles.features(coords, radius), function(feature) {
+            return mcCalculateDistance(feature.geometry.coordinates, coords) <= radius;
+        });
+    } else {
+        mcStats.near();
+    }
+}
+
+/* Snapshots the saved locations and the stats rows as of a download, so
+   history moves with the data and not with whatever the user opens */
+function mc_record_history(features, then, streets) {
+    const values = {};
+
+    streets.forEach(street => {
+        const found = features.find(feature => is_saved_feature(feature, street));
+        if (found) {
+            values[mc_history_key(found.properties)] = mc_history_status(found.properties);
+        }
+    });
+
+    mc_stats_near(mcTiles.position());
+    mcStats.results(mc_stat_count()).forEach(row => {
+        if (row.near_me) return;
+        values['c:' + row.city] = Math.round(parseFloat(row.broken));
+    });
+
+    mcHistory.record(then, values);
+}
+
+function format_and_send(result, ctx) {
     let index = 0;
 
     const message = [];
     
-    const keys_markers = [ 'dot', 'city', 'street', 'last_checked' ];
-    const keys_stats = [ 'city', 'broken', 'total_locations' ];
+    const keys_markers = [ 'dot', 'city', 'street', 'last_checked', 'distance', 'checked_minutes', 'broken_since' ];
+    const keys_int = [ 'total_locations', 'distance', 'checked_minutes', 'broken_since' ];
+    const keys_stats = [ 'city', 'broken', 'total_locations', 'history' ];
 
     var keys = [];
     var mc_message_string = [];
 
-    switch (type) {
+    switch (ctx.type) {
         case 0:
             keys = keys_markers;
             mc_message_string = "mc_marker_data";
             result.forEach(feature => {
                 if (feature.properties) {
-                    message.push(feature.properties);
+                    message.push(Object.assign({}, feature.properties, {
+                        distance: feature.geometry && feature.geometry.distance !== undefined
+                            ? Math.round(feature.geometry.distance * 1000) : 0,
+                        /* -1 sorts placeholders after real rows on the watch */
+                        checked_minutes: feature.placeholder ? -1 : mcCheckedMinutes(feature.properties.last_checked),
+                        broken_since: mcHistory.since(mc_history_key(feature.properties), history_status.broken)
+                    }));
                 }
             });
             break;
@@ -263,7 +328,9 @@ function format_and_send(type, result, id) {
 
         keys.forEach(key => {
             if (obj.hasOwnProperty(key)) {
-                if (key === 'total_locations') {
+                if (Array.isArray(obj[key])) {
+                    new_message[key] = obj[key];
+                } else if (keys_int.includes(key)) {
                     var location_int = parseInt(obj[key]);
                     if (isNaN(location_int)) {
                         new_message[key] = 0;
@@ -274,7 +341,11 @@ function format_and_send(type, result, id) {
                     new_message[key] = obj[key].toString();
                 }
             } else {
-                if (key === 'total_locations') {
+                if (key === 'history') {
+                    return;
+                } else if (key === 'checked_minutes' || key === 'broken_since') {
+                    new_message[key] = -1;
+                } else if (keys_int.includes(key)) {
                     new_message[key] = 0;
                 } else if (key === 'broken') {
                     new_message[key] = '0';
@@ -287,32 +358,29 @@ function format_and_send(type, result, id) {
         new_message['mc_message'] = mc_message_string;
         new_message['index'] = index;
         new_message['count'] = message.length;
-        new_message['id'] = id;
+        new_message['id'] = ctx.id;
         
         index++;
         return new_message;
     });
 
     if (message.length > 0) {
-        mcSend(filtered_message, id);
+        mcTransport.send(filtered_message, ctx.id, ctx.live);
     } else {
-        sendmcError(current_request, error.no_loc_found, id); 
+        sendmcError(ctx, error.no_loc_found); 
     }
+
+    ctx.done();
 }
 
-function fetch_mcdata_and_sort_by_saved(id) {
-    let max_saved_mc_count = 5
-    
+function mc_saved_streets() {
     try {
         var settings = JSON.parse(localStorage.getItem("clay-settings"));
     } catch (error) {
         console.log(error);
     }
     
-    if (!settings) {
-        sendmcError(request.type_markers, error.no_loc_saved, id);
-        return;
-    }
+    if (!settings) return [];
 
     const streets_input_arr = [ 
         settings.mc_save_slot_1,
@@ -322,153 +390,188 @@ function fetch_mcdata_and_sort_by_saved(id) {
         settings.mc_save_slot_5
     ];
 
-    if (streets_input_arr.every(element => element === "")) {
-        sendmcError(request.type_markers, error.no_loc_saved, id); 
-        return;
-    }
+    return streets_input_arr
+        .map(element => (element || '').toLowerCase().trim())
+        .filter(Boolean);
+}
+
+function is_saved_feature(feature, street) {
+    if (street.length < 4) return false;
+    if (!feature.properties || !feature.properties.street) return false;
+    return feature.properties.street.toLowerCase().trim().includes(street);
+}
 
-    const streets_input = streets_input_arr.map(element => element.toLowerCase().trim());
+function fetch_mcdata_and_sort_by_saved(ctx) {
+    let max_saved_mc_count = 5
     
-    const streets = streets_input.filter(Boolean);
+    const streets = mc_saved_streets();
 
-    mcRequestMarkers(id)
-        .then(function(mcdata) {
-            if (id !== current_id) return;
+    if (streets.length === 0) {
+        sendmcError(ctx, error.no_loc_saved); 
+        ctx.done();
+        return;
+    }
 
-            if ('features' in mcdata === false) {
-                format_and_send([], id);
-                return;
-            }
+    mcRequestMarkers(ctx)
+        .then(function() {
+            if (!ctx.live()) return;
 
+            /* saved locations always live in pinned tiles */
+            const features = mcTiles.features();
             const results = [];
        
-            /* This is kinda jank and inefficient. Whatever, it's fast enough */
-            let has_pushed;
-            for (let i = 0; i < streets.filter(Boolean).length; i++) {
-                has_pushed = false;
-                mcdata.features.filter(feature => {
-                    if (!feature.properties || !feature.properties.street) return;
-                    if (feature.properties.street.toLowerCase().trim().includes(streets[i])) {
-                        if (has_pushed || streets[i].length < 4) return;
-                        results.push(feature);
-                        has_pushed = true;
-                    }
-                });
-                if (!has_pushed) {
+            streets.forEach(street => {
+                const found = features.find(feature => is_saved_feature(feature, street));
+                if (found) {
+                    results.push(found);
+                } else {
                     /* I'm doing the parse stringify workaround 
                         because structuredClone doesn't work in the emulator */
                     results.push(JSON.parse(JSON.stringify(not_found_feature)));
                 }
-            }
-        
+            });
+
             const results_sliced = new Set(results.slice(0, max_saved_mc_count));
 
-            format_and_send(0, results_sliced, id);
+            format_and_send(results_sliced, ctx);
         });
 }
 
-function fetch_mcdata_and_sort_by_location(coords, id) {
-    let radius = 8.04672
-    let max_nearby_mc_count = 5
+function fetch_mcdata_and_sort_by_location(coords, ctx) {
+    let km_per_mile = 1.609344
+    /* the watch filters and re-sorts these by itself */
+    let max_nearby_mc_count = 20
+    let max_radius = 25 * km_per_mile
+    let rank = mcNearby.rank.nearest
 
-    mcRequestMarkers(id)
-        .then(function(mcdata) {
-            if (id !== current_id) return;
+    try {
+        var settings = JSON.parse(localStorage.getItem("clay-settings"));
+    } catch (error) {
+        console.log(error);
+    }
 
-            if ('features' in mcdata === false) {
-                format_and_send([], id);
-                return;
-            }
+    if (settings) {
+        if (parseInt(settings.mc_nearby_count) > 0) {
+            max_nearby_mc_count = Math.min(parseInt(settings.mc_nearby_count), max_nearby_mc_count);
+        }
+        if (parseFloat(settings.mc_nearby_max_distance) > 0) {
+            max_radius = parseFloat(settings.mc_nearby_max_distance) * km_per_mile;
+        }
+        if (settings.mc_nearby_rank) {
+            rank = settings.mc_nearby_rank;
+        }
+    }
 
-            mcdata.features.forEach(feature => {
-                if (feature.geometry && Object.hasOwn(feature.geometry, 'coordinates')) {
-                    feature.geometry.distance = mcCalculateDistance(feature.geometry.coordinates, coords);
-                } else {
-                    feature['geometry'] = { coordinates: [0,0], type: 'Point' };
-                    feature.geometry.distance = mcCalculateDistance([0,0], coords);
-                }
-            });
-        
-            const results = mcdata.features.filter(feature => {
-                return feature.geometry.distance <= radius;
-            }).sort((a, b) => {
-                return a.geometry.distance - b.geometry.distance;
-            });
-        
-            const results_sliced = new Set(results.slice(0, max_nearby_mc_count));
-    
-            format_and_send(request.type_markers, results_sliced, id);
+    mcTiles.locate(coords, max_radius);
+
+    function query() {
+        return mcNearby.query(coords, {
+            count: max_nearby_mc_count,
+            max_radius: max_radius,
+            rank: rank,
+            distance: mcCalculateDistance,
+            checked_minutes: mcCheckedMinutes,
+            covers: mcTiles.covers
         });
-}
+    }
 
-function gps_success(pos) {
-    if (id_gps !== current_id) return;
-    var cur_location = [ pos.coords.latitude, pos.coords.longitude ];
-    fetch_mcdata_and_sort_by_location(cur_location, id_gps);
-}
+    mcRequestMarkers(ctx)
+        .then(function() {
+            if (!ctx.live()) return;
+
+            const results = query();
+            if (results) {
+                format_and_send(new Set(results), ctx);
+                return;
+            }
 
-function gps_error(err) {
-    if (id_gps !== current_id) return;
-    sendmcError(request.type_markers, error.no_gps, id_gps);
+            /* the search went past the tiles we kept (or we moved away
+               from them), get the whole thing again */
+            mcRequestMarkers(ctx, true)
+                .then(function() {
+                    if (!ctx.live()) return;
+                    format_and_send(new Set(query() || []), ctx);
+                });
+        });
 }
 
-function start_mc_gps(id) {
+function start_mc_gps(ctx) {
     var gps_options = {
         enableHighAccuracy: true,
         maximumAge: 30000,
         timeout: 12000
     };
-    
-    id_gps = id;
 
-    mcRequestMarkers(id)
-        .then(function() {
-            if (id !== current_id) return;
-            navigator.geolocation.getCurrentPosition(gps_success, gps_error, gps_options);
-        });
+    /* location first, so we know which tiles we need before deciding
+       whether to download anything */
+    mcGetPosition(ctx, gps_options, function(coords) {
+        fetch_mcdata_and_sort_by_location(coords, ctx);
+    }, function() {
+        sendmcError(ctx, error.no_gps);
+        ctx.done();
+    });
 }
 
-function fetch_mcdata_stats(id) {
-    let mc_stat_count;
+function fetch_mcdata_stats(ctx) {
+    function send_stats(coords) {
+        if (!ctx.live()) return;
 
-    try {
-        var settings = JSON.parse(localStorage.getItem("clay-settings"));
-    } catch (error) {
-        console.log(error);
-    }
-    
-    if (!settings || !settings.mc_stat_count) {
-        mc_stat_count = 16;
-    } else {
-        mc_stat_count = settings.mc_stat_count;
-    }
+        mc_stats_near(coords);
+        const results = mcStats.results(mc_stat_count());
 
-    mcRequestStats(id)
-        .then(function(mcdata) {
-            const results = [];
+        results.forEach(row => {
+            if (row.near_me) return;
+            row.history = mcHistory.series('c:' + row.city, history_points)
+                .map(value => value === null ? history_status.unknown : value);
+        });
 
-            if (mcdata.broken) {
-                results.push({
-                    city: 'Currently Broken',
-                    broken: mcdata.broken,
-                    total_locations: 0
-                });
-            }
-            
-            if (mcdata.cities) {
-                mcdata.cities.forEach(city => {
-                    results.push(city);
-                });
-            }
-            
-            const results_sliced = new Set(results.slice(0, mc_stat_count));            
+        const results_sliced = new Set(results);
 
-            format_and_send(request.type_stats, results_sliced, id);
+        format_and_send(results_sliced, ctx);
+    }
+
+    /* the national numbers need a full download, tiles alone won't do */
+    mcRequestMarkers(ctx, mcStats.then() !== mcTiles.then())
+        .then(function() {
+            if (!ctx.live()) return;
+
+            /* near me is a bonus, so don't hold the stats up on a fresh fix,
+               wherever the nearby view last saw us will do */
+            send_stats(mcTiles.position());
         });
 }
 
+/* warms the marker tiles before the user picks anything */
+function mc_prefetch() {
+    mcScheduler.schedule({
+        priority: mcScheduler.priority.prefetch,
+        type: request.type_markers,
+        run: ctx => mcRequestMarkers(ctx).then(ctx.done)
+    });
+}
+
+/* refreshes markers in the background once they're getting old, so the
+   next view doesn't have to wait on a download */
+function mc_revalidate() {
+    if (mcScheduler.pending(mcScheduler.priority.revalidate)) return;
+
+    mcScheduler.schedule({
+        priority: mcScheduler.priority.revalidate,
+        type: request.type_markers,
+        run: ctx => {
+            const age = new Date().getTime() - mcTiles.then();
+            if (age < cache_max_age * 500) {
+                ctx.done();
+                return;
+            }
+            mcRequestMarkers(ctx, true).then(ctx.done);
+        }
+    });
+}
+
 Pebble.addEventListener('ready', function() {
     Pebble.sendAppMessage({ 'mc_message': "mc_ready" });
+    mc_prefetch();
     console.log('Im lovin it!');
 });
 
@@ -482,28 +585,39 @@ Pebble.addEventListener('webviewclosed', function(e) {
     }
     
     var dict = clay.getSettings(e.response);
+
+    /* saved locations may have moved to tiles we dropped */
+    mcTiles.expire();
     Pebble.sendAppMessage({ 'mc_refresh': '' });
 });
 
+const mc_views = [
+    { type: request.type_markers, run: start_mc_gps },
+    { type: request.type_markers, run: fetch_mcdata_and_sort_by_saved },
+    { type: request.type_stats, run: fetch_mcdata_stats }
+];
+
 Pebble.addEventListener("appmessage", function(e) {
-    current_id = e.payload.id;
-    mc_selected = e.payload.mc_message;
-    mcLoad();
-});
+    if (e.payload.missing !== undefined) {
+        mcTransport.resend(e.payload.id, e.payload.missing);
+        return;
+    }
 
-function mcLoad() {
-    switch (mc_selected) {
-        case 0:
-        start_mc_gps(current_id);
-        current_request = request.type_markers;
-            break;
-        case 1:
-        fetch_mcdata_and_sort_by_saved(current_id);
-        current_request = request.type_markers;
-            break;
-        case 2:
-        fetch_mcdata_stats(current_id);
-        current_request = request.type_stats;
-            break;
+    /* the watch only ever waits on one view, anything older is dead */
+    if (view_ctx) {
+        view_ctx.cancel();
+        view_ctx = undefined;
     }
-}
+
+    const view = mc_views[e.payload.mc_message];
+    if (!view || !e.payload.id) return;
+
+    view_ctx = mcScheduler.schedule({
+        id: e.payload.id,
+        type: view.type,
+        priority: mcScheduler.priority.view,
+        run: view.run
+    });
+
+    mc_revalidate();
+});
@@ -0,0 +1,90 @@
+/* K nearest search over the marker tiles. Starts with a small circle around
+   the user and doubles it until it holds `count` hits or reaches
+   `max_radius`, so somewhere with a McDonald's on every corner only ever
+   looks at a tile or two, and somewhere rural still gets an answer. */
+
+var mcTiles = require('./tiles');
+
+const first_radius = 2; // km
+const fresh_km_per_hour = 2; // how far we'd go to see a result an hour fresher
+const unknown_checked_minutes = 24 * 60;
+
+const mc_rank = Object.freeze({
+    nearest: 'nearest',
+    nearest_working: 'nearest_working',
+    fresh: 'fresh'
+});
+
+function is_working(feature) {
+    return feature.properties.is_active && !feature.properties.is_broken;
+}
+
+function fresh_score(feature, options) {
+    var minutes = options.checked_minutes(feature.properties.last_checked);
+    if (minutes < 0) {
+        minutes = unknown_checked_minutes;
+    }
+    return feature.geometry.distance + fresh_km_per_hour * minutes / 60;
+}
+
+function compare(rank, options) {
+    switch (rank) {
+        case mc_rank.nearest_working:
+            return (a, b) => (is_working(b) - is_working(a)) || (a.geometry.distance - b.geometry.distance);
+        case mc_rank.fresh:
+            return (a, b) => fresh_score(a, options) - fresh_score(b, options);
+        default:
+            return (a, b) => a.geometry.distance - b.geometry.distance;
+    }
+}
+
+/* a copy of feature carrying its distance, so the distance from this
+   search never ends up on the features mcTiles keeps (and persists) */
+function with_distance(feature, distance) {
+    return Object.assign({}, feature, {
+        geometry: Object.assign({}, feature.geometry, { distance: distance })
+    });
+}
+
+/* what counts towards `count` before we stop growing the circle */
+function is_hit(rank, feature) {
+    return rank === mc_rank.nearest_working ? is_working(feature) : true;
+}
+
+/* Up to options.count features around coords, ranked by options.rank.
+   options.distance(coordinates, coords) gives km, and
+   options.checked_minutes(last_checked) turns last_checked into minutes.
+   Returns null if the circle has to grow past what
+   options.covers(coords, radius) says the tiles hold. */
+function mcNearbyQuery(coords, options) {
+    const rank = mc_rank[options.rank] ? options.rank : mc_rank.nearest;
+    const seen = {};
+    const candidates = [];
+    var radius = Math.min(first_radius, options.max_radius);
+
+    for (;;) {
+        if (options.covers && !options.covers(coords, radius)) return null;
+
+        mcTiles.ring(coords, radius, seen).forEach(feature => {
+            candidates.push(with_distance(feature,
+                options.distance(feature.geometry.coordinates, coords)));
+        });
+
+        const hits = candidates.filter(feature => {
+            return feature.geometry.distance <= radius && is_hit(rank, feature);
+        });
+
+        if (hits.length >= options.count || radius >= options.max_radius) break;
+        radius = Math.min(radius * 2, options.max_radius);
+    }
+
+    return candidates
+        .filter(feature => feature.geometry.distance <= radius)
+        .sort(compare(rank, options))
+        .slice(0, options.count);
+}
+
+module.exports = {
+    rank: mc_rank,
+    query: mcNearbyQuery
+};
@@ -0,0 +1,129 @@
+/* Every piece of work gets its own context instead of sharing a pile of
+   globals: what the watch asked for, how important it is, and where it is
+   in its life (queued -> running -> done, or cancelled). Whatever the user
+   is looking at runs straight away; prefetching and background
+   revalidation only run when nothing more important is going on. Network
+   and GPS access go through use() so only so many of each run at once, and
+   the most important waiter gets the next free slot. */
+
+const mc_priority = Object.freeze({
+    view: 0,
+    prefetch: 1,
+    revalidate: 2
+});
+
+const mc_state = Object.freeze({
+    queued: 'queued',
+    running: 'running',
+    cancelled: 'cancelled',
+    done: 'done'
+});
+
+const limits = {
+    network: 1,
+    gps: 1
+};
+
+const max_background_jobs = 1;
+
+var jobs = [];
+var active = {};
+var waiting = {};
+var next_seq = 0;
+
+Object.keys(limits).forEach(resource => {
+    active[resource] = 0;
+    waiting[resource] = [];
+});
+
+function by_priority(a, b) {
+    return a.priority - b.priority || a.seq - b.seq;
+}
+
+function running_count(filter) {
+    return jobs.filter(ctx => ctx.state === mc_state.running && filter(ctx)).length;
+}
+
+function pump() {
+    jobs = jobs.filter(ctx => ctx.state === mc_state.queued || ctx.state === mc_state.running);
+
+    jobs.filter(ctx => ctx.state === mc_state.queued)
+        .sort(by_priority)
+        .forEach(ctx => {
+            if (ctx.priority !== mc_priority.view) {
+                /* speculative work waits for the user's stuff to finish */
+                if (running_count(job => job.priority === mc_priority.view) > 0) return;
+                if (running_count(job => job.priority !== mc_priority.view) >= max_background_jobs) return;
+            }
+
+            ctx.state = mc_state.running;
+            ctx.run(ctx);
+        });
+}
+
+function finish(ctx, state) {
+    /* a done job can still be cancelled to stop whatever it left streaming */
+    if (ctx.state === mc_state.cancelled || ctx.state === state) return;
+    ctx.state = state;
+    setTimeout(pump, 0);
+}
+
+function drain(resource) {
+    waiting[resource].sort((a, b) => by_priority(a.ctx, b.ctx));
+
+    while (active[resource] < limits[resource] && waiting[resource].length > 0) {
+        const entry = waiting[resource].shift();
+        let released = false;
+
+        active[resource]++;
+        entry.work(function release() {
+            if (released) return;
+            released = true;
+            active[resource]--;
+            drain(resource);
+        });
+    }
+}
+
+/* Queues a job. `options` wants an id (the watch's request id, if any), a
+   type (request.type_*), a priority (mc_priority.*) and run(ctx). run()
+   must call ctx.done() or ctx.cancel() when it's finished. */
+function mcSchedule(options) {
+    const ctx = {
+        id: options.id,
+        type: options.type,
+        priority: options.priority,
+        seq: next_seq++,
+        state: mc_state.queued,
+        run: options.run
+    };
+
+    /* still worth sending things for? done jobs may still be streaming */
+    ctx.live = () => ctx.state !== mc_state.cancelled;
+    ctx.done = () => finish(ctx, mc_state.done);
+    ctx.cancel = () => finish(ctx, mc_state.cancelled);
+
+    /* runs work(release) once a `resource` slot is free, work has to call
+       release() when it's done with it. Work still runs if the job got
+       cancelled in the meantime, since others may be counting on it, so
+       check ctx.live() if that matters. */
+    ctx.use = (resource, work) => {
+        waiting[resource].push({ ctx: ctx, work: work });
+        drain(resource);
+    };
+
+    jobs.push(ctx);
+    pump();
+    return ctx;
+}
+
+function mcPending(priority) {
+    return jobs.some(ctx => ctx.priority === priority
+        && (ctx.state === mc_state.queued || ctx.state === mc_state.running));
+}
+
+module.exports = {
+    priority: mc_priority,
+    schedule: mcSchedule,
+    pending: mcPending
+};
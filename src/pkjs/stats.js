@@ -0,0 +1,209 @@
+/* Stats built straight from markers.json, so we don't need to download
+   stats.json on top of it. Every location is tallied into its city and
+   state once, and after that only locations whose status changed between
+   downloads touch the counters. */
+
+const mc_status = Object.freeze({
+    working: 0,
+    broken: 1,
+    inactive: 2
+});
+
+var locations = {};
+var cities = {};
+var states = {};
+var national = new_tally();
+var near_me = null;
+var last_then;
+
+function new_tally() {
+    return { broken: 0, active: 0, total: 0 };
+}
+
+/* street alone isn't unique (blank streets, two stores on one street), so
+   throw in where it is too */
+function feature_key(feature) {
+    const props = feature.properties;
+    const coordinates = (feature.geometry && feature.geometry.coordinates) || [];
+    return (props.street || '') + '|' + (props.city || '') + '|' + (props.state || '')
+        + '|' + coordinates.join(',');
+}
+
+function city_name(city, state) {
+    if (!city) return null;
+    return state ? city + ', ' + state : city;
+}
+
+function feature_status(props) {
+    if (!props.is_active) return mc_status.inactive;
+    return props.is_broken ? mc_status.broken : mc_status.working;
+}
+
+function tally(counter, status, sign) {
+    counter.total += sign;
+    if (status === mc_status.inactive) return;
+    counter.active += sign;
+    if (status === mc_status.broken) {
+        counter.broken += sign;
+    }
+}
+
+function tally_group(groups, name, status, sign) {
+    if (!name) return;
+    if (!groups[name]) {
+        groups[name] = new_tally();
+    }
+    tally(groups[name], status, sign);
+    if (groups[name].total <= 0) {
+        delete groups[name];
+    }
+}
+
+function tally_location(location, sign) {
+    tally(national, location.status, sign);
+    tally_group(cities, city_name(location.city, location.state), location.status, sign);
+    tally_group(states, location.state, location.status, sign);
+}
+
+function broken_percentage(counter) {
+    if (!counter.active) return '0';
+    return (counter.broken / counter.active * 100).toFixed(1);
+}
+
+function stat_row(name, counter) {
+    return {
+        city: name,
+        broken: broken_percentage(counter),
+        total_locations: counter.total
+    };
+}
+
+/* Folds a markers.json feature list into the counters. `then` is the time
+   the list was downloaded, nothing happens if we've already seen it. */
+function mcStatsRefresh(features, then) {
+    if (then === last_then) return;
+
+    const seen = {};
+
+    features.forEach(feature => {
+        const props = feature.properties;
+        if (!props) return;
+
+        /* exact duplicates still each count once */
+        let key = feature_key(feature);
+        while (seen[key]) {
+            key += '+';
+        }
+
+        const status = feature_status(props);
+        const old = locations[key];
+        seen[key] = true;
+
+        if (old && old.status === status && old.city === props.city && old.state === props.state) {
+            return;
+        }
+
+        if (old) {
+            tally_location(old, -1);
+        }
+
+        locations[key] = { status: status, city: props.city, state: props.state };
+        tally_location(locations[key], 1);
+    });
+
+    Object.keys(locations).forEach(key => {
+        if (seen[key]) return;
+        tally_location(locations[key], -1);
+        delete locations[key];
+    });
+
+    last_then = then;
+}
+
+/* Counts the features `in_radius` says yes to as "near me". Pass nothing to
+   leave the near me rows out. */
+function mcStatsNear(features, in_radius) {
+    if (!features) {
+        near_me = null;
+        return;
+    }
+
+    const near = new_tally();
+    const near_states = {};
+    const near_cities = {};
+
+    features.forEach(feature => {
+        const props = feature.properties;
+        if (!props || !in_radius(feature)) return;
+
+        const status = feature_status(props);
+        tally(near, status, 1);
+        tally_group(near_states, props.state, status, 1);
+        tally_group(near_cities, city_name(props.city, props.state), status, 1);
+    });
+
+    near_me = {
+        tally: near,
+        state: most_locations(near_states),
+        city: most_locations(near_cities)
+    };
+}
+
+function mcStatsThen() {
+    return last_then;
+}
+
+function most_locations(groups) {
+    let best;
+    Object.keys(groups).forEach(name => {
+        if (!best || groups[name].total > groups[best].total) {
+            best = name;
+        }
+    });
+    return best;
+}
+
+/* Rows for the stats view, in the same shape stats.json used to give us */
+function mcStatsResults(count) {
+    const results = [];
+    const used = {};
+
+    if (!national.total) return results;
+
+    results.push({
+        city: 'Currently Broken',
+        broken: broken_percentage(national),
+        total_locations: 0
+    });
+
+    if (near_me && near_me.tally.total) {
+        /* wherever the user happens to be, so it has no history of its own */
+        results.push(Object.assign(stat_row('your area', near_me.tally), { near_me: true }));
+
+        if (near_me.city && cities[near_me.city]) {
+            results.push(stat_row(near_me.city, cities[near_me.city]));
+            used[near_me.city] = true;
+        }
+
+        if (near_me.state && states[near_me.state]) {
+            results.push(stat_row(near_me.state, states[near_me.state]));
+        }
+    }
+
+    Object.keys(cities)
+        .filter(name => !used[name])
+        .sort((a, b) => cities[b].total - cities[a].total)
+        .slice(0, Math.max(count - results.length, 0))
+        .forEach(name => {
+            results.push(stat_row(name, cities[name]));
+        });
+
+    return results.slice(0, count);
+}
+
+module.exports = {
+    refresh: mcStatsRefresh,
+    near: mcStatsNear,
+    then: mcStatsThen,
+    results: mcStatsResults
+};
@@ -0,0 +1,258 @@
+/* Keeps markers.json split up into tiles of tile_size degrees so we only hang
+   on to the part of the country that matters: the tiles around wherever the
+   user last was, the tiles their saved locations are in, and a handful of
+   recently used ones. Everything else gets dropped after a download and
+   comes back with the next one. Only the home and saved tiles are written
+   to localStorage, so a warm start reads a few kilobytes instead of the
+   whole thing. Searches wider than home stay in memory only. */
+
+const tile_size = 0.25; // degrees
+const km_per_degree = 111.32;
+const max_extra_tiles = 8;
+const home_radius = 25; // km, what gets persisted around the user
+const max_search_radius = 81; // km, a bit over the 50 mile nearby setting
+const storage_key = 'mc_tiles';
+
+var tiles = {};
+var loaded = {};
+var pinned = {};
+var position = null;
+var search_radius = home_radius;
+var then = 0;
+var complete = false;
+var located = false; // has locate() run since the app started
+
+function tile_index(value) {
+    return Math.floor(value / tile_size);
+}
+
+function tile_key(lat_index, lon_index) {
+    return lat_index + ':' + lon_index;
+}
+
+function feature_tile_key(feature) {
+    const coordinates = feature.geometry && feature.geometry.coordinates;
+    if (!coordinates) return tile_key(0, 0);
+    return tile_key(tile_index(coordinates[1]), tile_index(coordinates[0]));
+}
+
+/* every tile key that could hold something within radius km of coords */
+function keys_around(coords, radius) {
+    const lat_reach = radius / km_per_degree;
+    const lon_reach = radius / (km_per_degree * Math.max(Math.cos(coords[0] * Math.PI / 180), 0.01));
+    const keys = [];
+
+    for (let lat = tile_index(coords[0] - lat_reach); lat <= tile_index(coords[0] + lat_reach); lat++) {
+        for (let lon = tile_index(coords[1] - lon_reach); lon <= tile_index(coords[1] + lon_reach); lon++) {
+            keys.push(tile_key(lat, lon));
+        }
+    }
+
+    return keys;
+}
+
+function home_keys(radius) {
+    if (!position) return [];
+    return keys_around(position, radius || home_radius);
+}
+
+/* strip a feature down to what the app actually reads */
+function compact(feature) {
+    const props = feature.properties || {};
+    return {
+        geometry: { coordinates: feature.geometry ? feature.geometry.coordinates : [0,0], type: 'Point' },
+        properties: {
+            is_broken: props.is_broken,
+            is_active: props.is_active,
+            dot: props.dot,
+            state: props.state,
+            city: props.city,
+            street: props.street,
+            last_checked: props.last_checked
+        },
+        type: 'Feature'
+    };
+}
+
+function persist() {
+    const home = {};
+    home_keys().forEach(key => { home[key] = true; });
+
+    const stored = {};
+    Object.keys(tiles).forEach(key => {
+        if (home[key] || pinned[key]) {
+            stored[key] = tiles[key].features;
+        }
+    });
+
+    try {
+        localStorage.setItem(storage_key, JSON.stringify({
+            then: then,
+            position: position,
+            pinned: Object.keys(pinned),
+            tiles: stored
+        }));
+    } catch (error) {
+        console.log(error);
+    }
+}
+
+function restore() {
+    var stored;
+    try {
+        stored = JSON.parse(localStorage.getItem(storage_key));
+    } catch (error) {
+        console.log(error);
+    }
+
+    if (!stored || !stored.tiles) return;
+
+    then = stored.then || 0;
+    position = stored.position || null;
+    (stored.pinned || []).forEach(key => { pinned[key] = true; });
+
+    home_keys().forEach(key => { loaded[key] = true; });
+    Object.keys(stored.tiles).forEach(key => {
+        tiles[key] = { features: stored.tiles[key], used: 0 };
+        loaded[key] = true;
+    });
+}
+
+/* Drops every tile that isn't within search_radius of the user, pinned, or
+   one of the most recently used leftovers */
+function prune() {
+    const keep = {};
+    home_keys(search_radius).forEach(key => { keep[key] = true; });
+    Object.keys(pinned).forEach(key => { keep[key] = true; });
+
+    Object.keys(tiles)
+        .filter(key => !keep[key] && tiles[key].used > 0)
+        .sort((a, b) => tiles[b].used - tiles[a].used)
+        .slice(0, max_extra_tiles)
+        .forEach(key => { keep[key] = true; });
+
+    Object.keys(tiles).forEach(key => {
+        if (keep[key]) return;
+        delete tiles[key];
+    });
+
+    loaded = keep;
+}
+
+/* Replaces the store with a fresh markers.json feature list. Tiles holding
+   a feature `is_pinned` says yes to are kept no matter what. */
+function mcTilesIngest(features, download_time, is_pinned) {
+    const old = tiles;
+
+    tiles = {};
+    pinned = {};
+
+    features.forEach(feature => {
+        const key = feature_tile_key(feature);
+        if (!tiles[key]) {
+            tiles[key] = { features: [], used: old[key] ? old[key].used : 0 };
+        }
+        tiles[key].features.push(compact(feature));
+
+        if (is_pinned && is_pinned(feature)) {
+            pinned[key] = true;
+        }
+    });
+
+    then = download_time;
+
+    /* no idea where the user is this time around (a restored position can
+       be miles out of date), so hold on to everything until we do */
+    complete = !located;
+    if (!complete) {
+        prune();
+    }
+    persist();
+}
+
+/* Remembers where the user is, returns false if the store doesn't have
+   everything within radius km of there. Anything past home_radius is only
+   kept around until the app closes. */
+function mcTilesLocate(coords, radius) {
+    position = coords;
+    located = true;
+    search_radius = Math.min(Math.max(radius || 0, home_radius), max_search_radius);
+
+    if (complete) {
+        complete = false;
+        prune();
+    }
+
+    persist();
+    return mcTilesCovers(coords, radius);
+}
+
+function mcTilesCovers(coords, radius) {
+    return complete || keys_around(coords, radius).every(key => loaded[key]);
+}
+
+/* Features within (roughly) radius km of coords, or every resident feature
+   if coords is left out */
+function mcTilesFeatures(coords, radius) {
+    const keys = coords ? keys_around(coords, radius) : Object.keys(tiles);
+    const now = new Date().getTime();
+    const results = [];
+
+    keys.forEach(key => {
+        if (!tiles[key]) return;
+        if (coords) {
+            tiles[key].used = now;
+        }
+        tiles[key].features.forEach(feature => {
+            results.push(feature);
+        });
+    });
+
+    return results;
+}
+
+/* Like mcTilesFeatures, but skips tiles already in `seen` and adds the
+   ones it hands back, so growing rings never look at a tile twice */
+function mcTilesRing(coords, radius, seen) {
+    const now = new Date().getTime();
+    const results = [];
+
+    keys_around(coords, radius).forEach(key => {
+        if (seen[key]) return;
+        seen[key] = true;
+        if (!tiles[key]) return;
+
+        tiles[key].used = now;
+        tiles[key].features.forEach(feature => {
+            results.push(feature);
+        });
+    });
+
+    return results;
+}
+
+/* the last place locate() was told about, if any, restored ones included */
+function mcTilesPosition() {
+    return position;
+}
+
+function mcTilesThen() {
+    return then;
+}
+
+function mcTilesExpire() {
+    then = 0;
+}
+
+restore();
+
+module.exports = {
+    ingest: mcTilesIngest,
+    locate: mcTilesLocate,
+    covers: mcTilesCovers,
+    features: mcTilesFeatures,
+    ring: mcTilesRing,
+    position: mcTilesPosition,
+    then: mcTilesThen,
+    expire: mcTilesExpire
+};
@@ -0,0 +1,141 @@
+/* Streams rows to the watch with a few of them in flight at once instead of
+   waiting on every single ack. The row index doubles as the sequence number.
+   A row only goes out again when it gets nacked, when nothing comes back for
+   it in time, or when the watch asks for it because it never showed up. */
+
+const max_window_size = 4;
+const ack_timeout = 3000; // ms
+const max_retries = 5;
+const send_delay = 50; // ms
+const busy_backoff = 100; // ms
+const max_busy_backoff = 2000; // ms
+
+var stream = null;
+
+function nack_reason(e) {
+    if (e && e.error && e.error.message) return e.error.message;
+    if (e && e.data && e.data.error && e.data.error.message) return e.data.error.message;
+    return '';
+}
+
+function is_live(s) {
+    return s === stream && s.is_current();
+}
+
+function in_flight_count(s) {
+    return Object.keys(s.in_flight).length;
+}
+
+function pump(s) {
+    if (!is_live(s) || s.waiting) return;
+
+    while (s.queue.length > 0 && in_flight_count(s) < s.window_size) {
+        transmit(s, s.queue.shift());
+    }
+}
+
+function schedule_pump(s, delay) {
+    if (s.waiting) return;
+    s.waiting = setTimeout(() => {
+        s.waiting = undefined;
+        pump(s);
+    }, delay);
+}
+
+function queue_again(s, index) {
+    if (s.queue.indexOf(index) !== -1 || s.in_flight[index] !== undefined) return;
+    /* retransmits go first so the watch can finish in order */
+    s.queue.unshift(index);
+}
+
+function transmit(s, index) {
+    s.in_flight[index] = setTimeout(() => {
+        if (!is_live(s) || s.in_flight[index] === undefined) return;
+        delete s.in_flight[index];
+        retry(s, index, send_delay);
+    }, ack_timeout);
+
+    Pebble.sendAppMessage(s.messages[index], function() {
+        if (s.in_flight[index] === undefined) return;
+        clearTimeout(s.in_flight[index]);
+        delete s.in_flight[index];
+
+        s.acked[index] = true;
+        s.backoff = busy_backoff;
+        if (s.window_size < max_window_size) {
+            s.window_size++;
+        }
+
+        pump(s);
+    },
+    function(e) {
+        if (s.in_flight[index] === undefined) return;
+        clearTimeout(s.in_flight[index]);
+        delete s.in_flight[index];
+
+        if (nack_reason(e) === 'APP_MSG_BUSY') {
+            /* the watch is still chewing on earlier rows, so slow down */
+            s.window_size = 1;
+            retry(s, index, s.backoff);
+            s.backoff = Math.min(s.backoff * 2, max_busy_backoff);
+        } else {
+            console.log("I've McFallen! Resending row " + index + ".");
+            s.window_size = Math.max(Math.floor(s.window_size / 2), 1);
+            retry(s, index, send_delay);
+        }
+    });
+}
+
+function retry(s, index, delay) {
+    if (!is_live(s)) return;
+
+    s.retries[index] = (s.retries[index] || 0) + 1;
+    if (s.retries[index] > max_retries) {
+        console.log("I've McFallen! I'm Sorry! I've McFallen!");
+        return;
+    }
+
+    queue_again(s, index);
+    schedule_pump(s, delay);
+}
+
+/* Starts streaming `messages` for request `id`, replacing whatever stream
+   was going before. `is_current` is checked before every send so rows for
+   a request the watch gave up on stop going out. */
+function mcTransportSend(messages, id, is_current) {
+    const s = {
+        id: id,
+        messages: messages,
+        is_current: is_current,
+        queue: messages.map((message, index) => index),
+        in_flight: {},
+        acked: [],
+        retries: [],
+        window_size: 1,
+        backoff: busy_backoff,
+        waiting: undefined
+    };
+
+    if (stream && stream.waiting) {
+        clearTimeout(stream.waiting);
+    }
+
+    stream = s;
+    schedule_pump(s, send_delay);
+}
+
+/* The watch noticed a hole at `index`, send that row again */
+function mcTransportResend(id, index) {
+    const s = stream;
+    if (!s || s.id !== id || !s.messages[index]) return;
+
+    s.acked[index] = false;
+    s.retries[index] = 0;
+    queue_again(s, index);
+    pump(s);
+}
+
+module.exports = {
+    send: mcTransportSend,
+    resend: mcTransportResend
+};